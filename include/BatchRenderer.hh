@@ -0,0 +1,389 @@
+/**
+ * @file    BatchRenderer.hh
+ * @author  maxrt101
+ * @brief   Headless software raycaster, renders batches of cameras into one tensor
+*/
+
+#pragma once
+
+#include "Raycaster.hh"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+/**
+ * Renders N independent cameras against one shared map and texture set
+ * into a contiguous N x H x W x C byte tensor (RGB or RGBA), spread over
+ * all cores. No window or renderer is needed, textures must keep their
+ * pixels (loaded with a null renderer or keep_pixels), RGBA or indexed.
+ * Worker threads are started once and sleep between batches, render calls
+ * must not overlap.
+*/
+class BatchRenderer {
+public:
+    struct Camera {
+        mrt::vec2f pos;
+        float angle = 0.0f;
+
+        Camera() {}
+        Camera(const mrt::vec2f& pos, float angle) : pos(pos.x, pos.y), angle(angle) {}
+    };
+
+    struct Sprite {
+        mrt::vec2f pos;
+        int texture = 0;        // Index into the texture set
+
+        Sprite() {}
+        Sprite(const mrt::vec2f& pos, int texture) : pos(pos.x, pos.y), texture(texture) {}
+    };
+
+private:
+    // Reads texels of one mip level, indexed textures are expanded through the palette here
+    struct Sampler {
+        const Uint8* rgba = nullptr;
+        const Uint8* indices = nullptr;
+        const mrt::Palette* palette = nullptr;
+        int pitch = 0;
+        int w = 0;
+        int h = 0;
+
+        bool is_valid() const {
+            return rgba || (indices && palette);
+        }
+
+        inline const Uint8* get(int x, int y) const {
+            return indices ? palette->get_color(indices[y * w + x]) : rgba + y * pitch + x * 4;
+        }
+    };
+
+    // Per thread scratch buffers
+    struct Scratch {
+        std::vector<float> depth_buffer;
+        std::vector<std::pair<float, const Sprite*>> sprite_order;
+    };
+
+private:
+    const TileMap& map;
+    const std::vector<mrt::Texture>& textures;
+    std::vector<Sprite> sprites;
+    const mrt::Palette* palette = nullptr;
+
+    const int width;
+    const int height;
+    const int channels;
+    int thread_count;
+
+    float fov = PI / 2.5;
+    float depth = 30.0;
+    float step = 0.01f;
+
+    // Worker pool, the calling thread renders with thread_scratch[0]
+    std::vector<std::thread> workers;
+    std::vector<Scratch> thread_scratch;
+    std::mutex pool_mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    int generation = 0;         // Incremented for every batch
+    int busy_workers = 0;
+    bool stopping = false;
+
+    // Current batch, cameras are handed out through next
+    const Camera* batch_cameras = nullptr;
+    int batch_count = 0;
+    Uint8* batch_output = nullptr;
+    std::atomic<int> next {0};
+
+public:
+    BatchRenderer(const TileMap& map, const std::vector<mrt::Texture>& textures, int width, int height, int channels = 3, int thread_count = 0)
+        : map(map), textures(textures), width(width), height(height), channels(channels == 4 ? 4 : 3), thread_count(thread_count) {
+        if (channels != 3 && channels != 4) {
+            WARN("BatchRenderer supports 3 or 4 channels, got " << channels << ", using 3");
+        }
+
+        if (this->thread_count <= 0) {
+            this->thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (size_t i = 0; i < textures.size(); i++) {
+            if (!textures[i].get_pixels() && !textures[i].get_indices()) {
+                WARN("Texture " << i << " has no pixels, it won't be drawn");
+            }
+        }
+
+        thread_scratch.resize(this->thread_count);
+        for (Scratch& scratch : thread_scratch) {
+            scratch.depth_buffer.resize(width);
+        }
+
+        for (int t = 1; t < this->thread_count; t++) {
+            workers.emplace_back(&BatchRenderer::worker_loop, this, t);
+        }
+    }
+
+    ~BatchRenderer() {
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            stopping = true;
+        }
+        work_cv.notify_all();
+
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void set_sprites(const std::vector<Sprite>& sprites) {
+        this->sprites = sprites;
+    }
+
+    /**
+     * Expands indexed textures through this palette instead of their own,
+     * a tinted or shaded copy of the shared palette recolors them for free.
+     * nullptr restores the textures' palette.
+    */
+    void set_palette(const mrt::Palette* palette) {
+        this->palette = palette;
+    }
+
+    void set_fov(float fov) {
+        this->fov = fov;
+    }
+
+    void set_depth(float depth) {
+        this->depth = depth;
+    }
+
+    int get_width() const {
+        return width;
+    }
+
+    int get_height() const {
+        return height;
+    }
+
+    int get_channels() const {
+        return channels;
+    }
+
+    int get_thread_count() const {
+        return thread_count;
+    }
+
+    // Size of one camera's frame in bytes
+    size_t get_frame_size() const {
+        return (size_t)width * height * channels;
+    }
+
+    void render(const std::vector<Camera>& cameras, std::vector<Uint8>& output) {
+        output.resize(cameras.size() * get_frame_size());
+        render(cameras.data(), cameras.size(), output.data());
+    }
+
+    // output must hold count * get_frame_size() bytes
+    void render(const Camera* cameras, int count, Uint8* output) {
+        if (count <= 0) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            batch_cameras = cameras;
+            batch_count = count;
+            batch_output = output;
+            next = 0;
+            busy_workers = workers.size();
+            generation++;
+        }
+        work_cv.notify_all();
+
+        render_batch(thread_scratch[0]);
+
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        done_cv.wait(lock, [&]() { return busy_workers == 0; });
+    }
+
+private:
+    void worker_loop(int index) {
+        int seen = 0;
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(pool_mutex);
+                work_cv.wait(lock, [&]() { return stopping || generation != seen; });
+
+                if (stopping) {
+                    break;
+                }
+
+                seen = generation;
+            }
+
+            render_batch(thread_scratch[index]);
+
+            {
+                std::lock_guard<std::mutex> lock(pool_mutex);
+                busy_workers--;
+            }
+            done_cv.notify_one();
+        }
+    }
+
+    // Renders cameras of the current batch until none are left
+    void render_batch(Scratch& scratch) {
+        int i;
+        while ((i = next++) < batch_count) {
+            render_camera(batch_cameras[i], batch_output + i * get_frame_size(), scratch);
+        }
+    }
+
+    inline void put_pixel(Uint8* frame, int x, int y, Uint8 r, Uint8 g, Uint8 b) const {
+        Uint8* pixel = frame + ((size_t)y * width + x) * channels;
+        pixel[0] = r;
+        pixel[1] = g;
+        pixel[2] = b;
+        if (channels == 4) {
+            pixel[3] = SDL_ALPHA_OPAQUE;
+        }
+    }
+
+    Sampler get_sampler(const mrt::Texture& texture, int level) const {
+        Sampler sampler;
+        SDL_Surface* surface = texture.get_pixels(level);
+
+        if (surface) {
+            sampler.rgba = (const Uint8*)surface->pixels;
+            sampler.pitch = surface->pitch;
+        } else {
+            sampler.indices = texture.get_indices(level);
+            sampler.palette = palette ? palette : texture.get_palette();
+        }
+
+        sampler.w = texture.get_width(level);
+        sampler.h = texture.get_height(level);
+
+        return sampler;
+    }
+
+    inline void blend_pixel(Uint8* frame, int x, int y, const Uint8* texel) const {
+        Uint8* pixel = frame + ((size_t)y * width + x) * channels;
+        int a = texel[3];
+        for (int c = 0; c < 3; c++) {
+            pixel[c] = (texel[c] * a + pixel[c] * (255 - a)) / 255;
+        }
+    }
+
+    // Same layout as Raycaster::render_frame: black ceiling, solid floor, walls, then sprites
+    void render_camera(const Camera& camera, Uint8* frame, Scratch& scratch) const {
+        for (int y = 0; y < height; y++) {
+            Uint8 shade = y < height/2 ? 0 : 128;
+            for (int x = 0; x < width; x++) {
+                put_pixel(frame, x, y, shade, shade, shade);
+            }
+        }
+
+        draw_walls(camera, frame, scratch);
+        draw_sprites(camera, frame, scratch);
+    }
+
+    void draw_walls(const Camera& camera, Uint8* frame, Scratch& scratch) const {
+        for (int x = 0; x < width; x++) {
+            float ray_angle = (camera.angle - fov/2.0f) + ((float)x / (float)width) * fov;
+            RayHit hit = cast_ray(map, camera.pos, camera.angle, ray_angle, depth, step);
+
+            scratch.depth_buffer[x] = hit.distance;
+
+            // Nothing within view distance
+            if (!hit.is_wall) {
+                continue;
+            }
+
+            const mrt::Texture& texture = textures.at(map.get_tile(hit.tile));
+
+            // Same destination rows Raycaster::draw_column hands to SDL
+            WallProjection wall = project_wall(hit.distance, height);
+            int y_start = wall.y_start;
+            int y_size = wall.y_size;
+
+            if (y_size <= 0) {
+                continue;
+            }
+
+            Sampler texels = get_sampler(texture, texture.get_level(texture.get_height() / wall.height));
+            if (!texels.is_valid()) {
+                continue;
+            }
+
+            float whole;
+            int tx = std::min((int)(std::modf(hit.sample_x, &whole) * texels.w), texels.w - 1);
+
+            int y0 = std::max(0, y_start);
+            int y1 = std::min(height, y_start + y_size);
+
+            for (int y = y0; y < y1; y++) {
+                int ty = (y - y_start) * texels.h / y_size;
+                const Uint8* texel = texels.get(tx, ty);
+                put_pixel(frame, x, y, texel[0], texel[1], texel[2]);
+            }
+        }
+    }
+
+    void draw_sprites(const Camera& camera, Uint8* frame, Scratch& scratch) const {
+        // Far to near, so closer sprites are blended on top
+        scratch.sprite_order.clear();
+        for (const Sprite& sprite : sprites) {
+            mrt::vec2f vec(sprite.pos.x - camera.pos.x, sprite.pos.y - camera.pos.y);
+            scratch.sprite_order.push_back({sqrtf(vec.x*vec.x + vec.y*vec.y), &sprite});
+        }
+
+        std::sort(scratch.sprite_order.begin(), scratch.sprite_order.end(),
+            [](const std::pair<float, const Sprite*>& a, const std::pair<float, const Sprite*>& b) { return a.first > b.first; });
+
+        for (auto& entry : scratch.sprite_order) {
+            const mrt::Texture& texture = textures.at(entry.second->texture);
+            float object_aspect_ratio = (float)texture.get_height() / (float)texture.get_width();
+
+            SpriteProjection sprite;
+            if (!project_sprite(camera.pos, camera.angle, entry.second->pos, object_aspect_ratio, fov, depth, width, height, sprite)) {
+                continue;
+            }
+
+            Sampler texels = get_sampler(texture, texture.get_level(texture.get_height() / sprite.height));
+            if (!texels.is_valid()) {
+                continue;
+            }
+
+            // Same destination rect Raycaster::draw_objects hands to SDL
+            int y_start = sprite.ceiling;
+            int y_size = sprite.height;
+
+            if (y_size <= 0) {
+                continue;
+            }
+
+            int y0 = std::max(0, y_start);
+            int y1 = std::min(height, y_start + y_size);
+
+            for (int sx = 0; sx < sprite.width; sx++) {
+                int object_column = sprite.middle + sx - (sprite.width/2.0f);
+
+                if (object_column < 0 || object_column >= width || scratch.depth_buffer[object_column] < sprite.distance) {
+                    continue;
+                }
+
+                int tx = std::min((int)(sx / sprite.width * texels.w), texels.w - 1);
+
+                for (int y = y0; y < y1; y++) {
+                    int ty = (y - y_start) * texels.h / y_size;
+                    const Uint8* texel = texels.get(tx, ty);
+                    if (texel[3]) {
+                        blend_pixel(frame, object_column, y, texel);
+                    }
+                }
+            }
+        }
+    }
+};
@@ -10,6 +10,10 @@
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL.h>
 #include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #define SDL_ERROR(msg) std::cerr << "[\033[1;31m ERROR \033[0m] " << msg << "(" << SDL_GetError() << ")\n";
 #define ERROR(msg) std::cerr << "[\033[1;31m ERROR \033[0m] " << msg << "\n";
@@ -71,23 +75,83 @@ namespace mrt {
     typedef vec3<double> vec3d;
 
 
+    /**
+     * 256 entry RGBA color table shared by indexed textures.
+     * Entries are added as textures load, once it is full new colors map to the nearest one.
+    */
+    class Palette {
+    private:
+        Uint8 colors[256][4];
+        int size = 0;
+
+    public:
+        Palette();
+
+        int get_size() const;
+
+        // RGBA bytes of an entry
+        const Uint8* get_color(Uint8 index) const;
+        void set_color(Uint8 index, Uint8 r, Uint8 g, Uint8 b, Uint8 a = SDL_ALPHA_OPAQUE);
+
+        Uint8 find_or_add(const SDL_Color& color);
+        Uint8 find_nearest(Uint8 r, Uint8 g, Uint8 b) const;
+
+        // Copy with every entry multiplied by (r, g, b), for tint and shading effects
+        Palette tinted(float r, float g, float b) const;
+    };
+
+    /**
+     * Texture with a mip chain, level 0 is the full image and every next
+     * level is half the size of the previous one, down to 1x1.
+     * Levels are uploaded to the renderer, and kept as RGBA32 surfaces
+     * when keep_pixels is set or there is no renderer (software rendering).
+     * If a palette is given, 8-bit indexed images keep indices into it instead.
+     * Images without transparent texels are uploaded with blending disabled.
+    */
     class Texture {
     private:
-        SDL_Texture* texture_ptr = nullptr;
-        // SDL_Surface* pixels = nullptr;
+        std::vector<SDL_Texture*> levels;
+        std::vector<SDL_Surface*> pixels;
+        std::vector<std::vector<Uint8>> indices;
+        const Palette* palette = nullptr;
         int w = 0;
         int h = 0;
 
+    private:
+        bool load(SDL_Renderer* renderer, SDL_Surface* image, bool keep_pixels, Palette* palette);
+
+        static SDL_Surface* downsample(SDL_Surface* src);
+        static std::vector<Uint8> quantize(SDL_Surface* src, const Palette& palette);
+        static bool is_opaque(SDL_Surface* src);
+
     public:
-        Texture(SDL_Renderer* renderer, const std::string& path);
+        Texture(SDL_Renderer* renderer, const std::string& path, bool keep_pixels = false, Palette* palette = nullptr);
+
+        // Builds the texture from an image in memory, the image is not freed
+        Texture(SDL_Renderer* renderer, SDL_Surface* image, bool keep_pixels = false, Palette* palette = nullptr);
         Texture(Texture&& t);
         ~Texture();
 
-        SDL_Texture* get_sdl_texture() const;
-        SDL_Surface* get_pixels() const;
+        SDL_Texture* get_sdl_texture(int level = 0) const;
+        SDL_Surface* get_pixels(int level = 0) const;
 
-        int get_width() const;
-        int get_height() const;
+        // Indexed texels of a level, get_width(level) per row, nullptr if the texture isn't indexed
+        const Uint8* get_indices(int level = 0) const;
+        const Palette* get_palette() const;
+
+        // Bytes of texel data kept on the CPU side
+        size_t get_pixels_size() const;
+
+        int get_width(int level = 0) const;
+        int get_height(int level = 0) const;
+
+        int get_level_count() const;
+
+        /**
+         * Picks the level closest to one texel per screen pixel without going blurrier,
+         * texels_per_pixel is the level 0 texel count drawn over one pixel.
+        */
+        int get_level(float texels_per_pixel) const;
 
         // void read_pixels();
 
@@ -95,6 +159,26 @@ namespace mrt {
         // void draw_sample(SDL_Renderer* renderer, int sx, int sy, int w, int h, int dx, int dy, int dw, int dh);
     };
 
+    /**
+     * Two copies of T, one is read by the renderer while the other is written by the simulation.
+     * Not synchronized by itself, swap() must only be called when neither side is in flight.
+    */
+    template <typename T>
+    class DoubleBuffer {
+    private:
+        T buffers[2];
+        int front = 0;
+
+    public:
+        T& get_front() { return buffers[front]; }
+        const T& get_front() const { return buffers[front]; }
+
+        T& get_back() { return buffers[front ^ 1]; }
+        const T& get_back() const { return buffers[front ^ 1]; }
+
+        void swap() { front ^= 1; }
+    };
+
     struct KeyState {
         bool pressed = false;
         bool held = false;
@@ -128,8 +212,19 @@ namespace mrt {
         FrameKeyState keys[322];
         bool held_keys[322];
 
+        // Pipelined mode, the worker sleeps on simulation_cv between frames
+        bool pipelined = false;
+        bool render_warned = false;
+        std::thread simulation_thread;
+        std::mutex simulation_mutex;
+        std::condition_variable simulation_cv;
+        std::condition_variable simulation_done_cv;
+        int simulation_requested = 0;
+        int simulation_done = 0;
+        float simulation_frame_time = 0.0f;
+
     public:
-        PixelDraw(const std::string& name, int h, int w);
+        PixelDraw(const std::string& name, int h, int w, Uint32 window_flags = SDL_WINDOW_SHOWN);
         ~PixelDraw();
 
         void stop();
@@ -139,6 +234,7 @@ namespace mrt {
         int get_width() const;
 
         void set_fps_cap(int cap);
+        void set_pipelined(bool enable);
 
     protected:
         SDL_Window* get_window() const;
@@ -151,9 +247,28 @@ namespace mrt {
 
         Texture create_texture(const std::string& path) const;
 
+    private:
+        void simulation_loop();
+        void request_simulation(float frame_time);
+        void wait_simulation();
+
     public: // Interface
         virtual void on_load() = 0;
         virtual void on_frame_update(float frame_time) = 0;
+
+        /**
+         * Pipelined mode interface, used instead of on_frame_update.
+         * on_simulate runs on a worker thread and prepares frame N+1 while
+         * on_render draws frame N on the main thread. on_swap is called on
+         * the main thread between the two, when neither of them is running.
+         * Key state is only updated while the worker is idle, so on_simulate
+         * may use get_key_state.
+         * on_frame_update is never called in this mode, a subclass that only
+         * overrides it renders nothing (the default on_render warns once).
+        */
+        virtual void on_simulate(float) {}
+        virtual void on_swap() {}
+        virtual void on_render();
     };
 }
 
@@ -162,40 +277,323 @@ namespace mrt {
 #ifdef PIXELDRAW_IMPLEMENTATION
 
 #include <iostream>
+#include <algorithm>
+#include <climits>
 #include <chrono>
 
 namespace mrt {
 
-    Texture::Texture(SDL_Renderer* renderer, const std::string& path) {
-        texture_ptr = IMG_LoadTexture(renderer, path.c_str());
-        SDL_QueryTexture(texture_ptr, NULL, NULL, &w, &h);
+    Palette::Palette() {
+        memset(colors, 0, sizeof(colors));
+    }
+
+    int Palette::get_size() const {
+        return size;
+    }
+
+    const Uint8* Palette::get_color(Uint8 index) const {
+        return colors[index];
+    }
+
+    void Palette::set_color(Uint8 index, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+        colors[index][0] = r;
+        colors[index][1] = g;
+        colors[index][2] = b;
+        colors[index][3] = a;
+        size = std::max(size, index + 1);
+    }
+
+    Uint8 Palette::find_or_add(const SDL_Color& color) {
+        for (int i = 0; i < size; i++) {
+            if (colors[i][0] == color.r && colors[i][1] == color.g && colors[i][2] == color.b && colors[i][3] == color.a) {
+                return i;
+            }
+        }
+
+        if (size < 256) {
+            set_color(size, color.r, color.g, color.b, color.a);
+            return size - 1;
+        }
+
+        Uint8 nearest = find_nearest(color.r, color.g, color.b);
+        WARN("Palette is full, color (" << (int)color.r << ", " << (int)color.g << ", " << (int)color.b << ", " << (int)color.a
+             << ") is replaced by entry " << (int)nearest << " (" << (int)colors[nearest][0] << ", " << (int)colors[nearest][1]
+             << ", " << (int)colors[nearest][2] << ")");
+        return nearest;
+    }
+
+    Uint8 Palette::find_nearest(Uint8 r, Uint8 g, Uint8 b) const {
+        int nearest = 0;
+        int nearest_distance = INT_MAX;
+
+        for (int i = 0; i < size; i++) {
+            int dr = colors[i][0] - r;
+            int dg = colors[i][1] - g;
+            int db = colors[i][2] - b;
+            int distance = dr*dr + dg*dg + db*db;
+
+            if (distance < nearest_distance) {
+                nearest = i;
+                nearest_distance = distance;
+            }
+        }
+
+        return nearest;
+    }
+
+    Palette Palette::tinted(float r, float g, float b) const {
+        Palette result(*this);
+
+        for (int i = 0; i < size; i++) {
+            result.colors[i][0] = std::min(255.0f, colors[i][0] * r);
+            result.colors[i][1] = std::min(255.0f, colors[i][1] * g);
+            result.colors[i][2] = std::min(255.0f, colors[i][2] * b);
+        }
+
+        return result;
+    }
+
+    Texture::Texture(SDL_Renderer* renderer, const std::string& path, bool keep_pixels, Palette* palette) {
+        SDL_Surface* image = IMG_Load(path.c_str());
+        if (!image) {
+            SDL_ERROR("Can't load texture '" << path << "'");
+            return;
+        }
+
+        if (!load(renderer, image, keep_pixels, palette)) {
+            SDL_ERROR("Can't convert texture '" << path << "'");
+        }
+
+        SDL_FreeSurface(image);
+    }
+
+    Texture::Texture(SDL_Renderer* renderer, SDL_Surface* image, bool keep_pixels, Palette* palette) {
+        if (!load(renderer, image, keep_pixels, palette)) {
+            SDL_ERROR("Can't convert texture");
+        }
+    }
+
+    bool Texture::load(SDL_Renderer* renderer, SDL_Surface* image, bool keep_pixels, Palette* palette) {
+        keep_pixels = keep_pixels || !renderer;
+
+        // Color keyed images need alpha, so they stay RGBA
+        Uint32 colorkey;
+        bool indexed = keep_pixels && palette && image->format->BitsPerPixel == 8
+            && image->format->palette && SDL_GetColorKey(image, &colorkey) != 0;
+
+        if (indexed) {
+            this->palette = palette;
+
+            // Only colors some texel uses go into the shared palette
+            bool used[256] {false};
+            for (int y = 0; y < image->h; y++) {
+                const Uint8* row = (const Uint8*)image->pixels + y * image->pitch;
+                for (int x = 0; x < image->w; x++) {
+                    used[row[x]] = true;
+                }
+            }
+
+            Uint8 remap[256] {0};
+            SDL_Palette* source = image->format->palette;
+            for (int i = 0; i < source->ncolors && i < 256; i++) {
+                if (used[i]) {
+                    remap[i] = palette->find_or_add(source->colors[i]);
+                }
+            }
+
+            // Level 0 maps exactly while the palette has room, smaller levels are quantized from their filtered colors
+            std::vector<Uint8> level(image->w * image->h);
+            for (int y = 0; y < image->h; y++) {
+                const Uint8* row = (const Uint8*)image->pixels + y * image->pitch;
+                for (int x = 0; x < image->w; x++) {
+                    level[y * image->w + x] = remap[row[x]];
+                }
+            }
+
+            indices.push_back(std::move(level));
+        }
+
+        SDL_Surface* level = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_RGBA32, 0);
+
+        if (!level) {
+            this->palette = nullptr;
+            indices.clear();
+            return false;
+        }
+
+        w = level->w;
+        h = level->h;
+
+        // RGBA32 surfaces get alpha blending, opaque walls don't need it
+        bool opaque = is_opaque(level);
+
+        while (true) {
+            if (renderer) {
+                SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, level);
+                if (texture && opaque) {
+                    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+                }
+                levels.push_back(texture);
+            }
+
+            SDL_Surface* next = (level->w == 1 && level->h == 1) ? nullptr : downsample(level);
+
+            if (indexed) {
+                if (next) {
+                    indices.push_back(quantize(next, *palette));
+                }
+                SDL_FreeSurface(level);
+            } else if (keep_pixels) {
+                pixels.push_back(level);
+            } else {
+                SDL_FreeSurface(level);
+            }
+
+            if (!next) {
+                break;
+            }
+
+            level = next;
+        }
+
+        return true;
     }
 
     Texture::Texture(Texture&& t) {
-        texture_ptr = t.texture_ptr;
+        levels = std::move(t.levels);
+        pixels = std::move(t.pixels);
+        indices = std::move(t.indices);
+        palette = t.palette;
         w = t.w;
         h = t.h;
 
-        t.texture_ptr = nullptr;
+        t.levels.clear();
+        t.pixels.clear();
+        t.indices.clear();
     }
 
     Texture::~Texture() {
-        if (texture_ptr) {
-            DEBUG("Texture destroyed: " << texture_ptr);
-            SDL_DestroyTexture(texture_ptr);
+        for (SDL_Texture* level : levels) {
+            if (level) {
+                DEBUG("Texture destroyed: " << level);
+                SDL_DestroyTexture(level);
+            }
+        }
+
+        for (SDL_Surface* level : pixels) {
+            SDL_FreeSurface(level);
+        }
+    }
+
+    SDL_Surface* Texture::downsample(SDL_Surface* src) {
+        int dw = std::max(1, src->w / 2);
+        int dh = std::max(1, src->h / 2);
+
+        SDL_Surface* dst = SDL_CreateRGBSurfaceWithFormat(0, dw, dh, 32, SDL_PIXELFORMAT_RGBA32);
+
+        for (int y = 0; y < dh; y++) {
+            Uint8* row = (Uint8*)dst->pixels + y * dst->pitch;
+
+            for (int x = 0; x < dw; x++) {
+                Uint32 r = 0, g = 0, b = 0, a = 0;
+
+                // 2x2 box filter, color weighted by alpha so transparent texels don't bleed in
+                for (int i = 0; i < 4; i++) {
+                    int sx = std::min(x * 2 + (i & 1), src->w - 1);
+                    int sy = std::min(y * 2 + (i >> 1), src->h - 1);
+                    Uint8* texel = (Uint8*)src->pixels + sy * src->pitch + sx * 4;
+
+                    r += texel[0] * texel[3];
+                    g += texel[1] * texel[3];
+                    b += texel[2] * texel[3];
+                    a += texel[3];
+                }
+
+                Uint8* texel = row + x * 4;
+                texel[0] = a ? r / a : 0;
+                texel[1] = a ? g / a : 0;
+                texel[2] = a ? b / a : 0;
+                texel[3] = a / 4;
+            }
+        }
+
+        return dst;
+    }
+
+    bool Texture::is_opaque(SDL_Surface* src) {
+        for (int y = 0; y < src->h; y++) {
+            const Uint8* row = (const Uint8*)src->pixels + y * src->pitch;
+            for (int x = 0; x < src->w; x++) {
+                if (row[x * 4 + 3] != SDL_ALPHA_OPAQUE) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    std::vector<Uint8> Texture::quantize(SDL_Surface* src, const Palette& palette) {
+        std::vector<Uint8> result(src->w * src->h);
+
+        for (int y = 0; y < src->h; y++) {
+            const Uint8* row = (const Uint8*)src->pixels + y * src->pitch;
+            for (int x = 0; x < src->w; x++) {
+                result[y * src->w + x] = palette.find_nearest(row[x * 4], row[x * 4 + 1], row[x * 4 + 2]);
+            }
+        }
+
+        return result;
+    }
+
+    SDL_Texture* Texture::get_sdl_texture(int level) const {
+        return level < (int)levels.size() ? levels[level] : nullptr;
+    }
+
+    SDL_Surface* Texture::get_pixels(int level) const {
+        return level < (int)pixels.size() ? pixels[level] : nullptr;
+    }
+
+    const Uint8* Texture::get_indices(int level) const {
+        return level < (int)indices.size() ? indices[level].data() : nullptr;
+    }
+
+    const Palette* Texture::get_palette() const {
+        return palette;
+    }
+
+    size_t Texture::get_pixels_size() const {
+        size_t size = 0;
+
+        for (SDL_Surface* level : pixels) {
+            size += level->h * level->pitch;
         }
+
+        for (const std::vector<Uint8>& level : indices) {
+            size += level.size();
+        }
+
+        return size;
     }
 
-    SDL_Texture* Texture::get_sdl_texture() const {
-        return texture_ptr;
+    int Texture::get_width(int level) const {
+        return std::max(1, w >> level);
     }
 
-    int Texture::get_width() const {
-        return w;
+    int Texture::get_height(int level) const {
+        return std::max(1, h >> level);
     }
 
-    int Texture::get_height() const {
-        return h;
+    int Texture::get_level_count() const {
+        return std::max(levels.size(), std::max(pixels.size(), indices.size()));
+    }
+
+    int Texture::get_level(float texels_per_pixel) const {
+        int level = 0;
+        while (texels_per_pixel >= 2.0f && level < get_level_count() - 1) {
+            texels_per_pixel *= 0.5f;
+            level++;
+        }
+        return level;
     }
 
     KeyState::KeyState() {}
@@ -203,7 +601,7 @@ namespace mrt {
     KeyState::KeyState(bool p, bool h, bool r) : pressed(p), held(h), released(r) {}
 
 
-    PixelDraw::PixelDraw(const std::string& name, int w, int h) : app_name(name), screen_width(w), screen_height(h) {
+    PixelDraw::PixelDraw(const std::string& name, int w, int h, Uint32 window_flags) : app_name(name), screen_width(w), screen_height(h) {
         std::cout << "mrt::PixelDraw v0.1\n";
 
         if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
@@ -216,7 +614,7 @@ namespace mrt {
             exit(EXIT_FAILURE);
         }
 
-        window = SDL_CreateWindow(app_name.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, screen_width, screen_height, SDL_WINDOW_SHOWN);
+        window = SDL_CreateWindow(app_name.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, screen_width, screen_height, window_flags);
 
         if (window == NULL) {
             SDL_ERROR("Window creation failed");
@@ -264,6 +662,17 @@ namespace mrt {
 
         running = true;
 
+        if (pipelined) {
+            simulation_requested = 0;
+            simulation_done = 0;
+            render_warned = false;
+            simulation_thread = std::thread(&PixelDraw::simulation_loop, this);
+
+            // Prepare the first frame
+            request_simulation(frame_time);
+            wait_simulation();
+        }
+
         while (running) {
             cycle_count++;
 
@@ -293,9 +702,20 @@ namespace mrt {
                 }
             }
 
-            clear_screen();
-            on_frame_update(frame_time);
-            update_screen();
+            if (pipelined) {
+                on_swap();
+                request_simulation(frame_time);
+
+                clear_screen();
+                on_render();
+                update_screen();
+
+                wait_simulation();
+            } else {
+                clear_screen();
+                on_frame_update(frame_time);
+                update_screen();
+            }
 
             // 1/30 s
             // 1/time = fps
@@ -310,6 +730,64 @@ namespace mrt {
             title += fps;
             SDL_SetWindowTitle(window, (char*)(title.c_str()));
         }
+
+        if (pipelined) {
+            {
+                std::lock_guard<std::mutex> lock(simulation_mutex);
+                simulation_requested = -1;
+            }
+            simulation_cv.notify_one();
+            simulation_thread.join();
+        }
+    }
+
+    void PixelDraw::on_render() {
+        if (!render_warned) {
+            WARN("Pipelined mode calls on_simulate/on_swap/on_render instead of on_frame_update, on_render isn't overridden");
+            render_warned = true;
+        }
+    }
+
+    void PixelDraw::simulation_loop() {
+        int frame = 0;
+
+        while (true) {
+            float frame_time;
+
+            {
+                std::unique_lock<std::mutex> lock(simulation_mutex);
+                simulation_cv.wait(lock, [&]() { return simulation_requested != frame; });
+
+                if (simulation_requested < 0) {
+                    break;
+                }
+
+                frame = simulation_requested;
+                frame_time = simulation_frame_time;
+            }
+
+            on_simulate(frame_time);
+
+            {
+                std::lock_guard<std::mutex> lock(simulation_mutex);
+                simulation_done = frame;
+            }
+            simulation_done_cv.notify_one();
+        }
+    }
+
+    void PixelDraw::request_simulation(float frame_time) {
+        {
+            std::lock_guard<std::mutex> lock(simulation_mutex);
+            simulation_frame_time = frame_time;
+            simulation_requested++;
+        }
+        simulation_cv.notify_one();
+    }
+
+    void PixelDraw::wait_simulation() {
+        std::unique_lock<std::mutex> lock(simulation_mutex);
+        simulation_done_cv.wait(lock, [&]() { return simulation_done == simulation_requested; });
     }
 
     int PixelDraw::get_height() const {
@@ -324,6 +802,14 @@ namespace mrt {
         fps_cap = cap * (4.0f/3.0f);
     }
 
+    void PixelDraw::set_pipelined(bool enable) {
+        if (running) {
+            WARN("Pipelined mode can't be changed while running");
+            return;
+        }
+        pipelined = enable;
+    }
+
     SDL_Window* PixelDraw::get_window() const {
         return window;
     }
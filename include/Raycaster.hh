@@ -0,0 +1,728 @@
+/**
+ * @file    Raycaster.hh
+ * @author  maxrt101
+ * @brief   Wolf3D-style raycaster built on top of PixelDraw
+*/
+
+#pragma once
+
+#include "PixelDraw.hh"
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+#define PI 3.14159f
+
+/**
+ * Empty-space hierarchy over the tile map.
+ * Level 0 holds a bit per tile, every next level holds a bit per 4x4 block
+ * of the previous one, set if any wall is inside. Cells outside a level's
+ * grid count as occupied, but a coarse block that straddles the map edge
+ * only looks at its in-map tiles, so the part outside the map is treated
+ * as empty. The ray's own bounds check stops it there.
+*/
+class OccupancyMap {
+public:
+    static const int levels = 3;    // 1x1, 4x4 and 16x16 tiles
+    static const int level_shift = 2;
+
+private:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        std::vector<uint64_t> bits;
+
+        bool get(int x, int y) const {
+            if (x < 0 || x >= width || y < 0 || y >= height) {
+                return true;
+            }
+            int i = y * width + x;
+            return (bits[i >> 6] >> (i & 63)) & 1;
+        }
+
+        void set(int x, int y) {
+            int i = y * width + x;
+            bits[i >> 6] |= uint64_t(1) << (i & 63);
+        }
+
+        void resize(int w, int h) {
+            width = w;
+            height = h;
+            bits.assign((w * h + 63) / 64, 0);
+        }
+    };
+
+    Level level_data[levels];
+
+public:
+    void build(const std::vector<int>& map, int map_width, int map_height) {
+        level_data[0].resize(map_width, map_height);
+        for (int y = 0; y < map_height; y++) {
+            for (int x = 0; x < map_width; x++) {
+                if (map[y * map_width + x] != 0) {
+                    level_data[0].set(x, y);
+                }
+            }
+        }
+
+        for (int l = 1; l < levels; l++) {
+            const Level& fine = level_data[l-1];
+            int block = 1 << level_shift;
+
+            level_data[l].resize((fine.width + block - 1) / block, (fine.height + block - 1) / block);
+            for (int y = 0; y < fine.height; y++) {
+                for (int x = 0; x < fine.width; x++) {
+                    if (fine.get(x, y)) {
+                        level_data[l].set(x >> level_shift, y >> level_shift);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Returns the coarsest level whose block around tile (x, y) is empty,
+     * or -1 if the tile itself is occupied.
+    */
+    int get_empty_level(int x, int y) const {
+        if (level_data[0].get(x, y)) {
+            return -1;
+        }
+
+        for (int l = levels-1; l > 0; l--) {
+            int shift = l * level_shift;
+            if (!level_data[l].get(x >> shift, y >> shift)) {
+                return l;
+            }
+        }
+
+        return 0;
+    }
+};
+
+// Tile map, 0 is empty space, anything else is an index into the wall textures
+struct TileMap {
+    int width = 0;
+    int height = 0;
+    std::vector<int> tiles;
+    OccupancyMap occupancy;
+
+    TileMap(int width, int height, const std::vector<int>& tiles) : width(width), height(height), tiles(tiles) {
+        occupancy.build(tiles, width, height);
+    }
+
+    inline int get_tile(int x, int y) const {
+        return tiles[y * width + x];
+    }
+
+    inline int get_tile(const mrt::vec2i& v) const {
+        return tiles[v.y * width + v.x];
+    }
+};
+
+// Result of a single ray traversal
+struct RayHit {
+    float distance = 0.0f;  // Perpendicular distance to the wall
+    float sample_x = 0.0f;  // Wall texture coordinate
+    mrt::vec2i tile;        // Tile that stopped the ray
+    int side = 0;
+    bool is_wall = false;   // False if nothing was hit within depth, tile is then not a map tile
+};
+
+/**
+ * Marches a ray at ray_angle from a camera at player looking at player_angle.
+ * Returns the first wall within depth, distance is corrected for fisheye.
+ * Samples are taken at whole multiples of step. With skip_empty, empty blocks
+ * of the occupancy map are crossed in one leap to the last sample inside them,
+ * which tests the same samples as the plain march.
+*/
+inline RayHit cast_ray(const TileMap& map, const mrt::vec2f& player, float player_angle, float ray_angle, float depth, float step, bool skip_empty = true) {
+    RayHit hit;
+
+    float distance_to_wall = 0;
+    int sample = 0;
+
+    bool hit_wall = false;
+
+    mrt::vec2f eye(
+        sinf(ray_angle),
+        cosf(ray_angle)
+    );
+
+    mrt::vec2i& test = hit.tile;
+
+    while (!hit_wall && distance_to_wall < depth) {
+        sample++;
+        distance_to_wall = sample * step;
+
+        test.x = player.x + eye.x * distance_to_wall;
+        test.y = player.y + eye.y * distance_to_wall;
+
+        if (test.x < 0 || test.x >= map.width || test.y < 0 || test.y >= map.height) {
+            hit_wall = true;
+            distance_to_wall = depth;
+        } else {
+            if (map.get_tile(test) != 0) {
+                hit_wall = true;
+                hit.is_wall = true;
+
+                mrt::vec2f block_mid(
+                    test.x + 0.5f,
+                    test.y + 0.5f
+                );
+                mrt::vec2f test_point(
+                    player.x + eye.x * distance_to_wall,
+                    player.y + eye.y * distance_to_wall
+                );
+
+                float test_angle = atan2f((test_point.y - block_mid.y), (test_point.x - block_mid.x));
+
+                if (test_angle >= -PI * 0.25f && test_angle < PI * 0.25f) {
+                    hit.sample_x = test_point.y - test.y;
+                    hit.side = 1;
+                }
+                if (test_angle >= PI * 0.25f && test_angle < PI * 0.75f) {
+                    hit.sample_x = test_point.x - test.x;
+                    hit.side = 0;
+                }
+                if (test_angle < -PI * 0.25f && test_angle >= -PI * 0.75f) {
+                    hit.sample_x = test_point.x - test.x;
+                    hit.side = 0;
+                }
+                if (test_angle >= PI * 0.75f || test_angle < -PI * 0.75f) {
+                    hit.sample_x = test_point.y - test.y;
+                    hit.side = 1;
+                }
+
+                distance_to_wall = distance_to_wall * cosf(ray_angle-player_angle);
+            } else if (skip_empty) {
+                // Leap to the last sample inside the largest empty block around the ray
+                int level = map.occupancy.get_empty_level(test.x, test.y);
+
+                if (level >= 0) {
+                    int shift = level * OccupancyMap::level_shift;
+                    float size = 1 << shift;
+
+                    mrt::vec2f block(
+                        (test.x >> shift) << shift,
+                        (test.y >> shift) << shift
+                    );
+
+                    float exit_x = eye.x > 0 ? (block.x + size - player.x) / eye.x : eye.x < 0 ? (block.x - player.x) / eye.x : depth;
+                    float exit_y = eye.y > 0 ? (block.y + size - player.y) / eye.y : eye.y < 0 ? (block.y - player.y) / eye.y : depth;
+                    // Resume at the last sample inside the block, it may round into the next tile so it is still tested
+                    int last = std::min(std::min(exit_x, exit_y), depth) / step - 1;
+
+                    if (last > sample) {
+                        sample = last;
+                    }
+                }
+            }
+        }
+    }
+
+    hit.distance = distance_to_wall;
+
+    return hit;
+}
+
+// Screen rows of a wall slice
+struct WallProjection {
+    float height = 0.0f;    // Projected height, picks the mip level
+    int y_start = 0;        // Destination rows, as handed to SDL
+    int y_size = 0;
+};
+
+inline WallProjection project_wall(float distance, int screen_height) {
+    WallProjection wall;
+    wall.height = (float)screen_height / distance;
+    wall.y_start = (float)(screen_height / 2.0f) - screen_height / distance / 2.0;
+    wall.y_size = wall.height;
+    return wall;
+}
+
+// Screen placement of a sprite
+struct SpriteProjection {
+    float distance = 0.0f;  // Distance from the camera
+    float ceiling = 0.0f;   // Top row
+    float height = 0.0f;
+    float width = 0.0f;
+    float middle = 0.0f;    // Center column
+};
+
+/**
+ * Projects a sprite at pos for a camera at player looking at player_angle,
+ * aspect_ratio is the texture's height over its width.
+ * Returns false if the sprite is out of view, closer than 0.5 or not within depth.
+*/
+inline bool project_sprite(const mrt::vec2f& player, float player_angle, const mrt::vec2f& pos, float aspect_ratio,
+                           float fov, float depth, int screen_width, int screen_height, SpriteProjection& sprite) {
+    mrt::vec2f eye(
+        sinf(player_angle),
+        cosf(player_angle)
+    );
+
+    mrt::vec2f vec(
+        pos.x - player.x,
+        pos.y - player.y
+    );
+
+    sprite.distance = sqrtf(vec.x*vec.x + vec.y*vec.y);
+
+    float object_angle = atan2f(eye.y, eye.x) - atan2f(vec.y, vec.x);
+    if (object_angle < -PI)
+        object_angle += 2.0f * PI;
+    if (object_angle > PI)
+        object_angle -= 2.0f * PI;
+
+    bool is_in_fov = fabs(object_angle) < fov / 2.0f;
+
+    if (!is_in_fov || sprite.distance < 0.5f || sprite.distance >= depth) {
+        return false;
+    }
+
+    sprite.ceiling = (float)(screen_height / 2.0f) - screen_height/sprite.distance/1.5;
+    float object_floor = screen_height - sprite.ceiling;
+    sprite.height = object_floor - sprite.ceiling;
+    sprite.width = sprite.height/aspect_ratio;
+    sprite.middle = (0.5f * (object_angle / (fov / 2.0f)) + 0.5f) * (float)screen_width;
+
+    return true;
+}
+
+class Raycaster : public mrt::PixelDraw {
+protected:
+    // GameObject
+    struct GameObject {
+        mrt::vec2f pos;         // Position
+        mrt::vec2f v;           // Velocity
+        bool remove;
+        mrt::Texture *texture;
+    };
+
+    // Everything the simulation writes and the renderer reads.
+    // Objects are a vector so copying the front state into the back one reuses its capacity
+    struct GameState {
+        mrt::vec2f player;
+        float player_angle = 0.0f;
+        std::vector<std::pair<int, GameObject>> objects;
+    };
+
+private:
+    std::string data_path;
+
+    float fov = PI / 2.5;
+    float depth = 30.0;
+
+    // Map
+    TileMap map = get_default_map();
+
+    // Parameters
+    float step = 0.01f;
+    int texture_column_width = 1;
+    int floor_scale = 2;
+
+    float rotation_speed = 3.0f;
+    float movement_speed = 4.0f;
+
+    SDL_Rect texture_source, texture_dest;
+    float *depth_buffer = nullptr;
+
+protected:
+    // Resources
+    SDL_Texture* buffer = nullptr;
+    std::vector<mrt::Texture> textures;
+    mrt::DoubleBuffer<GameState> state;
+
+private:
+    inline int get_map_tile(int x, int y) const {
+        return map.get_tile(x, y);
+    }
+
+    inline int get_map_tile(const mrt::vec2i& v) const {
+        return map.get_tile(v);
+    }
+
+public:
+    Raycaster(const std::string& data_path, Uint32 window_flags = SDL_WINDOW_SHOWN)
+        : PixelDraw("Raycaster", 640, 480, window_flags), data_path(data_path) {
+        state.get_front().player = mrt::vec2f(8.0, 8.0);
+        depth_buffer = new float[get_width()];
+
+        if (this->data_path[data_path.size()-1] != '/') {
+            this->data_path += '/';
+        }
+
+        // set_fps_cap(60);
+        buffer = SDL_CreateTexture(get_renderer(), SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, get_width(), get_height());
+    }
+
+    ~Raycaster() {
+        INFO("Unloading raycaster resources.");
+        delete [] depth_buffer;
+        SDL_DestroyTexture(buffer);
+    }
+
+    static TileMap get_default_map() {
+        return TileMap(24, 24, {
+            8,8,8,8,8,8,8,8,8,8,8,4,4,6,4,4,6,4,6,4,4,4,6,4,
+            8,0,0,0,0,0,0,0,0,0,8,4,0,0,0,0,0,0,0,0,0,0,0,4,
+            8,0,3,3,0,0,0,0,0,8,8,4,0,0,0,0,0,0,0,0,0,0,0,6,
+            8,0,0,3,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,6,
+            8,0,3,3,0,0,0,0,0,8,8,4,0,0,0,0,0,0,0,0,0,0,0,4,
+            8,0,0,0,0,0,0,0,0,0,8,4,0,0,0,0,0,6,6,6,0,6,4,6,
+            8,8,8,8,0,8,8,8,8,8,8,4,4,4,4,4,4,6,0,0,0,0,0,6,
+            7,7,7,7,0,7,7,7,7,0,8,0,8,0,8,0,8,4,0,4,0,6,0,6,
+            7,7,0,0,0,0,0,0,7,8,0,8,0,8,0,8,8,6,0,0,0,0,0,6,
+            7,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,8,6,0,0,0,0,0,4,
+            7,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,8,6,0,6,0,6,0,6,
+            7,7,0,0,0,0,0,0,7,8,0,8,0,8,0,8,8,6,4,6,0,6,6,6,
+            7,7,7,7,0,7,7,7,7,8,8,4,0,6,8,4,8,3,3,3,0,3,3,3,
+            2,2,2,2,0,2,2,2,2,4,6,4,0,0,6,0,6,3,0,0,0,0,0,3,
+            2,2,0,0,0,0,0,2,2,4,0,0,0,0,0,0,4,3,0,0,0,0,0,3,
+            2,0,0,0,0,0,0,0,2,4,0,0,0,0,0,0,4,3,0,0,0,0,0,3,
+            1,0,0,0,0,0,0,0,1,4,4,4,4,4,6,0,6,3,3,0,0,0,3,3,
+            2,0,0,0,0,0,0,0,2,2,2,1,2,2,2,6,6,0,0,5,0,5,0,5,
+            2,2,0,0,0,0,0,2,2,2,0,0,0,2,2,0,5,0,5,0,0,0,5,5,
+            2,0,0,0,0,0,0,0,2,0,0,0,0,0,2,5,0,5,0,5,0,5,0,5,
+            1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,5,
+            2,0,0,0,0,0,0,0,2,0,0,0,0,0,2,5,0,5,0,5,0,5,0,5,
+            2,2,0,0,0,0,0,2,2,2,0,0,0,2,2,0,5,0,5,0,0,0,5,5,
+            2,2,2,2,1,2,2,2,2,2,2,1,2,2,2,5,5,5,5,5,5,5,5,5
+        });
+    }
+
+    // Texture paths relative to the data folder, index matches map tiles
+    static std::vector<std::string> get_texture_paths() {
+        return {
+            "res/logo.png",
+            "res/wolf3d/WALL91.bmp",
+            "res/wolf3d/WALL0.bmp",
+            "res/wolf3d/WALL4.bmp",
+            "res/wolf3d/WALL10.bmp",
+            "res/wolf3d/WALL22.bmp",
+            "res/wolf3d/WALL20.bmp",
+            "res/wolf3d/WALL18.bmp",
+            "res/wolf3d/WALL44.bmp",
+            "res/sprites/barrel.png",
+            "res/sprites/pillar.png",
+            "res/fireball.png",
+        };
+    }
+
+    const TileMap& get_map() const {
+        return map;
+    }
+
+    void set_camera(const mrt::vec2f& pos, float angle) {
+        state.get_front().player = pos;
+        state.get_front().player_angle = angle;
+    }
+
+    void on_load() override {
+        for (const std::string& path : get_texture_paths()) {
+            textures.push_back(create_texture(data_path + path));
+        }
+
+        state.get_front().objects = {
+            {0, {{20.5f, 2.5f}, {0.0f, 0.0f}, false, &textures[9]}},
+            {0, {{5.5f,  2.5f}, {0.0f, 0.0f}, false, &textures[9]}},
+            {0, {{4.5f, 20.5f}, {0.0f, 0.0f}, false, &textures[10]}},
+            {0, {{11.5f,20.5f}, {0.0f, 0.0f}, false, &textures[10]}},
+        };
+    }
+
+    void on_frame_update(float frame_time) override {
+        on_simulate(frame_time);
+        on_swap();
+        on_render();
+    }
+
+    void on_simulate(float frame_time) override {
+        GameState& next = state.get_back();
+        next = state.get_front();
+
+        handle_input(next, frame_time);
+        update_objects(next, frame_time);
+        sort_objects(next);
+    }
+
+    void on_swap() override {
+        state.swap();
+    }
+
+    void on_render() override {
+        render_frame(state.get_front());
+    }
+
+protected:
+    void handle_input(GameState& state, float frame_time) {
+        mrt::vec2f& player = state.player;
+        float& player_angle = state.player_angle;
+
+        // Movement
+        if (get_key_state(SDL_SCANCODE_LEFT).held) {
+            player_angle -= rotation_speed * frame_time;
+        }
+
+        if (get_key_state(SDL_SCANCODE_RIGHT).held) {
+            player_angle += rotation_speed * frame_time;
+        }
+
+        if (get_key_state(SDL_SCANCODE_W).held) {
+            player.x += sinf(player_angle) * movement_speed * frame_time;
+            player.y += cosf(player_angle) * movement_speed * frame_time;
+
+            if (get_map_tile((int)player.x, (int)player.y) != 0) {
+                player.x -= sinf(player_angle) * movement_speed * frame_time;
+                player.y -= cosf(player_angle) * movement_speed * frame_time;
+            }
+        }
+
+        if (get_key_state(SDL_SCANCODE_S).held) {
+            player.x -= sinf(player_angle) * movement_speed * frame_time;
+            player.y -= cosf(player_angle) * movement_speed * frame_time;
+
+            if (get_map_tile((int)player.x, (int)player.y) != 0) {
+                player.x += sinf(player_angle) * movement_speed * frame_time;
+                player.y += cosf(player_angle) * movement_speed * frame_time;
+            }
+        }
+
+        if (get_key_state(SDL_SCANCODE_A).held) {
+            player.x -= cosf(player_angle) * movement_speed * frame_time;
+            player.y += sinf(player_angle) * movement_speed * frame_time;
+
+            if (get_map_tile((int)player.x, (int)player.y) != 0) {
+                player.x += cosf(player_angle) * movement_speed * frame_time;
+                player.y -= sinf(player_angle) * movement_speed * frame_time;
+            }
+        }
+
+        if (get_key_state(SDL_SCANCODE_D).held) {
+            player.x += cosf(player_angle) * movement_speed * frame_time;
+            player.y -= sinf(player_angle) * movement_speed * frame_time;
+
+            if (get_map_tile((int)player.x, (int)player.y) != 0) {
+                player.x -= cosf(player_angle) * movement_speed * frame_time;
+                player.y += sinf(player_angle) * movement_speed * frame_time;
+            }
+        }
+
+        if (get_key_state(SDL_SCANCODE_SPACE).pressed) {
+            GameObject o;
+            o.pos = player;
+            o.v = {sinf(player_angle) * 5, cosf(player_angle) * 5};
+            o.remove = false;
+            o.texture = &textures[11];
+            state.objects.push_back({0, o});
+        }
+    }
+
+    void render_frame(const GameState& state) {
+        begin_frame();
+
+        // Wall Rendering
+        for (int x = 0; x < get_width(); x+=texture_column_width) {
+            draw_column(x, cast_ray(state, x));
+        }
+
+        // Sprites rendering
+        draw_objects(state);
+
+        end_frame();
+    }
+
+    void begin_frame() {
+        int screen_width = get_width();
+        int screen_height = get_height();
+
+        // Set buffer as a rendering target, black ceiling
+        SDL_SetRenderTarget(get_renderer(), buffer);
+        SDL_SetRenderDrawColor(get_renderer(), 0, 0, 0, SDL_ALPHA_OPAQUE);
+        SDL_RenderClear(get_renderer());
+
+        // Solid floor rendering
+        texture_dest.x = 0;
+        texture_dest.y = screen_height/2;
+        texture_dest.w = screen_width;
+        texture_dest.h = screen_height/2;
+
+        SDL_SetRenderDrawColor(get_renderer(), 128, 128, 128, SDL_ALPHA_OPAQUE);
+        SDL_RenderFillRect(get_renderer(), &texture_dest);
+
+        /*
+        mrt::vec2f ray0(
+            sinf(player_angle-fov/2.0f),
+            cosf(player_angle-fov/2.0f)
+        );
+        mrt::vec2f ray1(
+            sinf(player_angle+fov/2.0f),
+            cosf(player_angle+fov/2.0f)
+        );
+
+        SDL_Texture* floor_texture = textures[1].get_sdl_texture();
+
+        int floor_texture_width = textures[1].get_width();
+        int floor_texture_height = textures[1].get_height();
+
+        texture_source.w = floor_scale;
+        texture_source.h = floor_scale;
+        texture_dest.w = floor_scale;
+        texture_dest.h = floor_scale;
+
+        // Floor Casting
+        for (int y = screen_height/2; y < screen_height; y+=floor_scale) {
+            int y_pos = y - screen_height/2;
+            float z = screen_height/2.0f;
+
+            float row_distance = z / y_pos;
+
+            mrt::vec2f floor_step(
+                floor_scale * row_distance * (ray1.x - ray0.x) / screen_width,
+                floor_scale * row_distance * (ray1.y - ray0.y) / screen_width
+            );
+
+            mrt::vec2f floor(
+                player.x + row_distance * ray0.x,
+                player.y + row_distance * ray0.y
+            );
+
+            texture_dest.y = y;
+
+            for (texture_dest.x = 0; texture_dest.x < screen_width; texture_dest.x+=floor_scale) {
+                mrt::vec2i texture_coords(
+                    (int)(floor_texture_width * (floor.x - (int)floor.x)) & (floor_texture_width-1),
+                    (int)(floor_texture_height * (floor.y - (int)floor.y)) & (floor_texture_height-1)
+                );
+
+                floor.x += floor_step.x;
+                floor.y += floor_step.y;
+
+                texture_source.x = texture_coords.x;
+                texture_source.y = texture_coords.y;
+
+                SDL_RenderCopy(get_renderer(), floor_texture, &texture_source, &texture_dest);
+            }
+        }*/
+    }
+
+    void end_frame() {
+        SDL_SetRenderTarget(get_renderer(), NULL);
+        SDL_RenderCopy(get_renderer(), buffer, NULL, NULL);
+    }
+
+    RayHit cast_ray(const GameState& state, int x) const {
+        float ray_angle = (state.player_angle - fov/2.0f) + ((float)x / (float)get_width()) * fov;
+        return ::cast_ray(map, state.player, state.player_angle, ray_angle, depth, step);
+    }
+
+    void draw_column(int x, const RayHit& hit) {
+        int screen_height = get_height();
+
+        // int ceiling = (float)(screen_height / 2.0f) - screen_height / ((float)distance_to_wall);
+        // int floor = screen_height - ceiling;
+        // unsigned char shade = 255 * (1 - distance_to_wall/depth);
+        // SDL_SetRenderDrawColor(get_renderer(), shade, shade, shade, SDL_ALPHA_OPAQUE);
+        // SDL_RenderDrawLine(get_renderer(), x, ceiling, x+1, floor);
+
+        depth_buffer[x] = hit.distance;
+
+        // Nothing within view distance
+        if (!hit.is_wall) {
+            return;
+        }
+
+        mrt::Texture& texture = textures.at(get_map_tile(hit.tile));
+
+        float whole;
+        WallProjection wall = project_wall(hit.distance, screen_height);
+        int level = texture.get_level(texture.get_height() / wall.height);
+
+        texture_source.x = (std::modf(hit.sample_x, &whole) * texture.get_width(level));
+        texture_source.y = 0;
+        texture_source.w = texture_column_width;
+        texture_source.h = texture.get_height(level);
+
+        texture_dest.x = x;
+        texture_dest.y = wall.y_start;
+        texture_dest.w = texture_column_width;
+        texture_dest.h = wall.y_size;
+
+        SDL_RenderCopy(get_renderer(), texture.get_sdl_texture(level), &texture_source, &texture_dest);
+    }
+
+    void update_objects(GameState& state, float frame_time) {
+        const mrt::vec2f& player = state.player;
+
+        for (auto &object : state.objects) {
+            object.second.pos.x += object.second.v.x * frame_time;
+            object.second.pos.y += object.second.v.y * frame_time;
+
+            if (get_map_tile(object.second.pos.x, object.second.pos.y) != 0) {
+                object.second.remove = true;
+            }
+
+            mrt::vec2f vec(
+                object.second.pos.x - player.x,
+                object.second.pos.y - player.y
+            );
+
+            object.first = sqrtf(vec.x*vec.x + vec.y*vec.y);
+        }
+    }
+
+    void draw_objects(const GameState& state) {
+        const mrt::vec2f& player = state.player;
+        const float player_angle = state.player_angle;
+
+        int screen_width = get_width();
+        int screen_height = get_height();
+
+        for (auto &object : state.objects) {
+            const mrt::Texture* texture = object.second.texture;
+            float object_aspect_ratio = (float)texture->get_height() / (float)texture->get_width();
+
+            SpriteProjection sprite;
+            if (project_sprite(player, player_angle, object.second.pos, object_aspect_ratio, fov, depth, screen_width, screen_height, sprite)) {
+                SDL_Rect texture_source, texture_dest;
+
+                float whole;
+                int level = texture->get_level(texture->get_height() / sprite.height);
+                SDL_Texture* object_texture = texture->get_sdl_texture(level);
+
+                for (int sx = 0; sx < sprite.width; sx++) {
+                    int object_column = sprite.middle + sx - (sprite.width/2.0f);
+
+                    texture_source.x = std::modf(sx / sprite.width, &whole) * texture->get_width(level);
+                    texture_source.y = 0;
+                    texture_source.w = 1;
+                    texture_source.h = texture->get_height(level);
+
+                    texture_dest.x = object_column;
+                    texture_dest.y = sprite.ceiling;
+                    texture_dest.w = 1;
+                    texture_dest.h = sprite.height;
+
+                    if (object_column >= 0 && object_column < screen_width && depth_buffer[object_column] >= sprite.distance) {
+                        SDL_RenderCopy(get_renderer(), object_texture, &texture_source, &texture_dest);
+                        // depth_buffer[object_column] = sprite.distance;
+                    }
+                }
+            }
+        }
+    }
+
+    void sort_objects(GameState& state) {
+        // Remove objects that shuold be removed
+        state.objects.erase(std::remove_if(state.objects.begin(), state.objects.end(),
+            [](const std::pair<int, GameObject>& p) { return p.second.remove; }), state.objects.end());
+
+        // Sort object by distance from player
+        std::sort(state.objects.begin(), state.objects.end(),
+            [](const std::pair<int, GameObject>& a, const std::pair<int, GameObject>& b) { return a.first > b.first; });
+    }
+};
@@ -0,0 +1,185 @@
+/**
+ * @file    bench.cc
+ * @author  maxrt101
+ * @brief   Raycaster kernel microbenchmarks
+ *
+ * Usage: bench <data path> [output.json] [iterations]
+*/
+
+#include "common.hh"
+
+#include <algorithm>
+
+// Batch rendering benchmark parameters
+static const int batch_size = 256;
+static const int batch_width = 128;
+static const int batch_height = 96;
+
+struct BenchResult {
+    double traversal_ns = 0;    // Ray traversal, per column
+    double sampling_ns = 0;     // Wall column sampling, per column
+    double sprites_ns = 0;      // Sprite update, projection and sort, per frame
+    double frame_ns = 0;        // Full frame, per frame
+};
+
+// Returns median time of a single run of f in nanoseconds
+template <typename F>
+double measure(int iterations, F f) {
+    std::vector<double> samples(iterations);
+
+    // Warm up caches and the renderer's command queue
+    f();
+
+    for (int i = 0; i < iterations; i++) {
+        test::Timer timer;
+        f();
+        samples[i] = timer.elapsed_ns();
+    }
+
+    std::sort(samples.begin(), samples.end());
+    return samples[iterations / 2];
+}
+
+// Renders the cameras in batches on the CPU, returns a JSON member with the results
+std::string bench_batch(const std::string& name, const test::Harness& raycaster, const std::vector<mrt::Texture>& textures,
+                        const std::vector<BatchRenderer::Camera>& cameras, int iterations) {
+    BatchRenderer batch(raycaster.get_map(), textures, batch_width, batch_height);
+    batch.set_sprites(raycaster.get_sprites());
+
+    size_t texture_bytes = 0;
+    for (const mrt::Texture& texture : textures) {
+        texture_bytes += texture.get_pixels_size();
+    }
+
+    std::vector<Uint8> observations;
+    double batch_ns = measure(std::max(1, iterations / 10), [&]() { batch.render(cameras, observations); });
+    double observations_per_second = cameras.size() * 1e9 / batch_ns;
+
+    INFO(name << ": " << cameras.size() << " cameras at " << batch_width << "x" << batch_height << " on "
+         << batch.get_thread_count() << " threads, " << observations_per_second << " observations/s, "
+         << texture_bytes << " texture bytes");
+
+    std::stringstream json;
+    json << "  \"" << name << "\": {"
+         << "\"cameras\": " << cameras.size() << ", "
+         << "\"width\": " << batch_width << ", "
+         << "\"height\": " << batch_height << ", "
+         << "\"channels\": " << batch.get_channels() << ", "
+         << "\"threads\": " << batch.get_thread_count() << ", "
+         << "\"texture_bytes\": " << texture_bytes << ", "
+         << "\"batch_ns\": " << batch_ns << ", "
+         << "\"observations_per_second\": " << observations_per_second << "}";
+    return json.str();
+}
+
+int main(int argc, char ** argv) {
+    if (argc < 2) {
+        ERROR("Usage: " << argv[0] << " <data path> [output.json] [iterations]");
+        return 1;
+    }
+
+    std::string output_path = argc > 2 ? argv[2] : "bench.json";
+    int iterations = argc > 3 ? atoi(argv[3]) : 100;
+
+    if (iterations <= 0) {
+        ERROR("Iteration count must be positive");
+        return 1;
+    }
+
+    test::Harness raycaster(argv[1]);
+    if (!raycaster.load()) {
+        return 1;
+    }
+
+    int columns = raycaster.get_width();
+
+    std::stringstream json;
+    json << "{\n"
+         << "  \"benchmark\": \"raycaster\",\n"
+         << "  \"width\": " << raycaster.get_width() << ",\n"
+         << "  \"height\": " << raycaster.get_height() << ",\n"
+         << "  \"iterations\": " << iterations << ",\n"
+         << "  \"results\": [\n";
+
+    for (int i = 0; i < test::pose_count; i++) {
+        const test::Pose& pose = test::poses[i];
+        raycaster.set_camera(pose.pos, pose.angle);
+
+        BenchResult result;
+        std::vector<RayHit> hits;
+
+        result.traversal_ns = measure(iterations, [&]() { raycaster.traverse(hits); }) / columns;
+        result.sampling_ns = measure(iterations, [&]() { raycaster.sample(hits); raycaster.finish(); }) / columns;
+        result.sprites_ns = measure(iterations, [&]() { raycaster.sprites(); raycaster.finish(); });
+        result.frame_ns = measure(iterations, [&]() { raycaster.frame(); });
+
+        double fps = 1e9 / result.frame_ns;
+
+        INFO(pose.name << ": traversal " << result.traversal_ns << " ns/column, sampling "
+             << result.sampling_ns << " ns/column, sprites " << result.sprites_ns << " ns, "
+             << fps << " fps");
+
+        json << "    {" << test::json_pose(pose) << ", "
+             << "\"traversal_ns_per_column\": " << result.traversal_ns << ", "
+             << "\"sampling_ns_per_column\": " << result.sampling_ns << ", "
+             << "\"sprites_ns_per_frame\": " << result.sprites_ns << ", "
+             << "\"frame_ns\": " << result.frame_ns << ", "
+             << "\"fps\": " << fps << "}"
+             << (i + 1 < test::pose_count ? ",\n" : "\n");
+    }
+
+    json << "  ],\n"
+         << "  \"open_map\": [\n";
+
+    // Long range traversal over empty space, with and without empty block leaps
+    TileMap open_map = test::get_open_map();
+
+    for (int i = 0; i < test::open_pose_count; i++) {
+        const test::Pose& pose = test::open_poses[i];
+        std::vector<RayHit> hits;
+
+        double march_ns = measure(iterations, [&]() { test::cast_rays(open_map, pose, columns, test::open_map_depth, false, hits); }) / columns;
+        double leap_ns = measure(iterations, [&]() { test::cast_rays(open_map, pose, columns, test::open_map_depth, true, hits); }) / columns;
+
+        INFO(pose.name << ": traversal " << march_ns << " ns/column marching, " << leap_ns << " ns/column with empty block leaps");
+
+        json << "    {" << test::json_pose(pose) << ", "
+             << "\"depth\": " << test::open_map_depth << ", "
+             << "\"march_ns_per_column\": " << march_ns << ", "
+             << "\"leap_ns_per_column\": " << leap_ns << ", "
+             << "\"speedup\": " << march_ns / leap_ns << "}"
+             << (i + 1 < test::open_pose_count ? ",\n" : "\n");
+    }
+
+    json << "  ],\n";
+
+    // Headless batch rendering throughput, with RGBA and with palettized textures
+    std::string data_path = argv[1];
+    if (data_path[data_path.size()-1] != '/') {
+        data_path += '/';
+    }
+
+    std::vector<BatchRenderer::Camera> cameras;
+    for (int i = 0; i < batch_size; i++) {
+        const test::Pose& pose = test::poses[i % test::pose_count];
+        cameras.push_back(BatchRenderer::Camera(pose.pos, pose.angle));
+    }
+
+    mrt::Palette palette;
+    std::vector<mrt::Texture> rgba_textures, indexed_textures;
+    for (const std::string& path : Raycaster::get_texture_paths()) {
+        rgba_textures.push_back(mrt::Texture(nullptr, data_path + path));
+        indexed_textures.push_back(mrt::Texture(nullptr, data_path + path, true, &palette));
+    }
+
+    json << bench_batch("batch", raycaster, rgba_textures, cameras, iterations) << ",\n"
+         << bench_batch("batch_palettized", raycaster, indexed_textures, cameras, iterations) << "\n"
+         << "}\n";
+
+    if (!test::write_file(output_path, json.str())) {
+        return 1;
+    }
+
+    INFO("Results written to " << output_path);
+    return 0;
+}
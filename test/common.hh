@@ -0,0 +1,177 @@
+/**
+ * @file    common.hh
+ * @author  maxrt101
+ * @brief   Shared camera poses and harness for raycaster benchmarks and golden-image tests
+*/
+
+#pragma once
+
+#define PIXELDRAW_IMPLEMENTATION
+#include "Raycaster.hh"
+#include "BatchRenderer.hh"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+
+namespace test {
+    struct Pose {
+        const char* name;
+        mrt::vec2f pos;
+        float angle;
+    };
+
+    // Fixed camera poses, cover open rooms, corridors and sprites in view
+    static const Pose poses[] = {
+        {"hall_long",      {4.5f,  9.5f},   PI / 2.0f},
+        {"corridor",       {4.5f,  13.5f},  0.0f},
+        {"room_diagonal",  {12.5f, 2.5f},   PI / 4.0f},
+        {"barrel_near",    {8.0f,  2.5f},   -PI / 2.0f},
+        {"barrel_far",     {14.5f, 3.5f},   PI / 2.0f},
+        {"pillars",        {7.5f,  20.5f},  PI / 2.0f},
+        {"courtyard",      {20.5f, 14.5f},  PI},
+        {"wall_close",     {1.2f,  1.2f},   PI * 1.25f},
+    };
+
+    static const int pose_count = sizeof(poses) / sizeof(poses[0]);
+
+    // Large map with walls only on the border, rays cross long stretches of empty blocks
+    static const int open_map_size = 200;
+    static const float open_map_depth = 300.0f;
+
+    static const Pose open_poses[] = {
+        {"open_center",    {100.5f, 100.5f}, PI / 4.0f},
+        {"open_corner",    {2.5f,   2.5f},   PI / 4.0f + 0.1f},
+        {"open_edge",      {100.5f, 1.5f},   0.0f},
+        {"open_axis",      {64.0f,  3.5f},   PI / 2.0f},
+    };
+
+    static const int open_pose_count = sizeof(open_poses) / sizeof(open_poses[0]);
+
+    // Same field of view, view distance and march step as the raycaster
+    static const float fov = PI / 2.5f;
+    static const float depth = 30.0f;
+    static const float step = 0.01f;
+
+    inline TileMap get_open_map() {
+        std::vector<int> tiles(open_map_size * open_map_size, 0);
+        for (int i = 0; i < open_map_size; i++) {
+            tiles[i] = 1;
+            tiles[(open_map_size - 1) * open_map_size + i] = 1;
+            tiles[i * open_map_size] = 1;
+            tiles[i * open_map_size + open_map_size - 1] = 1;
+        }
+        return TileMap(open_map_size, open_map_size, tiles);
+    }
+
+    // Casts one ray per column across the field of view, like Raycaster::cast_ray does for the screen
+    inline void cast_rays(const TileMap& map, const Pose& pose, int columns, float depth, bool skip_empty, std::vector<RayHit>& hits) {
+        hits.resize(columns);
+        for (int x = 0; x < columns; x++) {
+            float ray_angle = (pose.angle - fov/2.0f) + ((float)x / (float)columns) * fov;
+            hits[x] = cast_ray(map, pose.pos, pose.angle, ray_angle, depth, step, skip_empty);
+        }
+    }
+
+    // Exposes the raycaster kernels to the harness
+    class Harness : public Raycaster {
+    public:
+        Harness(const std::string& data_path) : Raycaster(data_path, SDL_WINDOW_HIDDEN) {}
+
+        bool load() {
+            on_load();
+
+            for (size_t i = 0; i < textures.size(); i++) {
+                if (!textures[i].get_sdl_texture()) {
+                    ERROR("Texture " << i << " failed to load, check data path");
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        void traverse(std::vector<RayHit>& hits) const {
+            hits.resize(get_width());
+            for (int x = 0; x < get_width(); x++) {
+                hits[x] = cast_ray(state.get_front(), x);
+            }
+        }
+
+        void sample(const std::vector<RayHit>& hits) {
+            begin_frame();
+            for (int x = 0; x < get_width(); x++) {
+                draw_column(x, hits[x]);
+            }
+            end_frame();
+        }
+
+        void sprites() {
+            GameState& current = state.get_front();
+            update_objects(current, 0.0f);
+            sort_objects(current);
+            draw_objects(current);
+        }
+
+        void frame() {
+            on_frame_update(0.0f);
+            finish();
+        }
+
+        // Blocks until the renderer has executed all queued commands
+        void finish() {
+            Uint32 pixel;
+            SDL_Rect rect {0, 0, 1, 1};
+            SDL_RenderReadPixels(get_renderer(), &rect, SDL_PIXELFORMAT_RGBA8888, &pixel, sizeof(pixel));
+        }
+
+        std::vector<BatchRenderer::Sprite> get_sprites() const {
+            std::vector<BatchRenderer::Sprite> sprites;
+            for (auto& object : state.get_front().objects) {
+                sprites.push_back(BatchRenderer::Sprite(object.second.pos, object.second.texture - &textures[0]));
+            }
+            return sprites;
+        }
+
+        void read_frame(std::vector<Uint32>& pixels) {
+            pixels.resize(get_width() * get_height());
+            SDL_SetRenderTarget(get_renderer(), buffer);
+            SDL_RenderReadPixels(get_renderer(), NULL, SDL_PIXELFORMAT_RGBA8888, pixels.data(), get_width() * sizeof(Uint32));
+            SDL_SetRenderTarget(get_renderer(), NULL);
+        }
+    };
+
+    class Timer {
+    private:
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        Timer() : start(std::chrono::steady_clock::now()) {}
+
+        double elapsed_ns() const {
+            return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    inline std::string json_pose(const Pose& pose) {
+        std::stringstream ss;
+        ss << "\"pose\": \"" << pose.name << "\", "
+           << "\"x\": " << pose.pos.x << ", "
+           << "\"y\": " << pose.pos.y << ", "
+           << "\"angle\": " << pose.angle;
+        return ss.str();
+    }
+
+    inline bool write_file(const std::string& path, const std::string& contents) {
+        std::ofstream file(path);
+        if (!file) {
+            ERROR("Can't open '" << path << "' for writing");
+            return false;
+        }
+        file << contents;
+        return true;
+    }
+}
@@ -0,0 +1,468 @@
+/**
+ * @file    golden.cc
+ * @author  maxrt101
+ * @brief   Golden-image regression test for the raycaster
+ *
+ * Usage: golden <data path> <golden dir> [output.json] [--update]
+ *
+ * Renders every pose from common.hh and compares it with <golden dir>/<pose>.bmp.
+ * A missing golden image is a failure, --update records all of them from the
+ * current output. Mismatching frames are saved as <pose>.actual.bmp.
+ * If the golden dir holds none of the images (nothing recorded yet), the
+ * comparison is skipped with a warning, the other checks still run.
+ *
+ * The same poses are rendered as one batch by BatchRenderer and compared with
+ * <golden dir>/batch_<pose>.bmp. The batch repeats every pose so frames land on
+ * different threads, it has to be byte-identical on one thread and on all
+ * cores (at least 4 threads), and its RGB tensor has to match the RGBA one.
+ *
+ * Finally cameras right in front of walls are rendered with palette indexed
+ * textures and with RGBA ones, up close walls only sample level 0, which
+ * maps exactly, so both have to match. A tinted palette has to recolor
+ * indexed walls and leave RGBA sprites as they are.
+*/
+
+#include "common.hh"
+
+#include <algorithm>
+#include <cstdlib>
+
+// Per-channel difference that is still considered equal (renderer rounding)
+static const int channel_tolerance = 2;
+
+// Fraction of pixels allowed to exceed channel_tolerance
+static const double mismatch_tolerance = 0.001;
+
+// How many times every pose appears in the batch
+static const int batch_repeats = 4;
+
+// Cameras half a tile away from a wall, every column samples mip level 0
+static const test::Pose close_poses[] = {
+    {"close_west",     {1.5f,  3.5f},  -PI / 2.0f},
+    {"close_east",     {22.5f, 1.5f},  PI / 2.0f},
+    {"close_north",    {12.5f, 1.5f},  PI},
+    {"close_corner",   {1.2f,  1.2f},  PI * 1.25f},
+};
+
+static const int close_pose_count = sizeof(close_poses) / sizeof(close_poses[0]);
+
+// Side of the walled room used for the tinted palette check
+static const int tint_room_size = 8;
+
+struct CompareResult {
+    int mismatched = 0;
+    int max_delta = 0;
+};
+
+static bool save_frame(const std::string& path, std::vector<Uint32>& pixels, int w, int h) {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels.data(), w, h, 32, w * sizeof(Uint32), SDL_PIXELFORMAT_RGBA8888);
+    if (!surface) {
+        SDL_ERROR("Can't create surface for '" << path << "'");
+        return false;
+    }
+
+    bool ok = SDL_SaveBMP(surface, path.c_str()) == 0;
+    if (!ok) {
+        SDL_ERROR("Can't save '" << path << "'");
+    }
+
+    SDL_FreeSurface(surface);
+    return ok;
+}
+
+static bool load_frame(const std::string& path, std::vector<Uint32>& pixels, int w, int h) {
+    SDL_Surface* bmp = SDL_LoadBMP(path.c_str());
+    if (!bmp) {
+        return false;
+    }
+
+    SDL_Surface* surface = SDL_ConvertSurfaceFormat(bmp, SDL_PIXELFORMAT_RGBA8888, 0);
+    SDL_FreeSurface(bmp);
+
+    if (!surface) {
+        SDL_ERROR("Can't convert '" << path << "'");
+        return false;
+    }
+
+    bool ok = surface->w == w && surface->h == h;
+    if (ok) {
+        pixels.resize(w * h);
+        for (int y = 0; y < h; y++) {
+            memcpy(&pixels[y * w], (Uint8*)surface->pixels + y * surface->pitch, w * sizeof(Uint32));
+        }
+    } else {
+        ERROR("'" << path << "' is " << surface->w << "x" << surface->h << ", expected " << w << "x" << h);
+    }
+
+    SDL_FreeSurface(surface);
+    return ok;
+}
+
+static CompareResult compare(const std::vector<Uint32>& actual, const std::vector<Uint32>& expected) {
+    CompareResult result;
+
+    for (size_t i = 0; i < actual.size(); i++) {
+        int delta = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            int a = (actual[i] >> shift) & 0xFF;
+            int b = (expected[i] >> shift) & 0xFF;
+            delta = std::max(delta, abs(a - b));
+        }
+
+        if (delta > channel_tolerance) {
+            result.mismatched++;
+        }
+        result.max_delta = std::max(result.max_delta, delta);
+    }
+
+    return result;
+}
+
+// Compares a frame with <golden dir>/<name>.bmp, or records it with update, returns the status
+static std::string check_golden(const std::string& golden_dir, const std::string& name, std::vector<Uint32>& actual,
+                                int w, int h, bool update, CompareResult& result) {
+    std::string golden_path = golden_dir + name + ".bmp";
+    std::vector<Uint32> expected;
+
+    if (update) {
+        return save_frame(golden_path, actual, w, h) ? "recorded" : "error";
+    }
+
+    if (!load_frame(golden_path, expected, w, h)) {
+        return "missing";
+    }
+
+    result = compare(actual, expected);
+    if (result.mismatched > mismatch_tolerance * w * h) {
+        save_frame(golden_dir + name + ".actual.bmp", actual, w, h);
+        return "fail";
+    }
+
+    return "pass";
+}
+
+// True if at least one golden image of the fixed poses exists in golden_dir
+static bool has_golden_images(const std::string& golden_dir) {
+    for (int i = 0; i < test::pose_count; i++) {
+        std::ifstream screen(golden_dir + test::poses[i].name + ".bmp");
+        std::ifstream batch(golden_dir + "batch_" + test::poses[i].name + ".bmp");
+        if (screen || batch) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Logs the status of a frame, returns true if it failed
+static bool report(const std::string& name, const std::string& status, const CompareResult& result) {
+    if (status == "missing") {
+        ERROR(name << ": no golden image, record it with --update");
+    } else if (status == "fail" || status == "error") {
+        ERROR(name << ": " << status << " (" << result.mismatched << " pixels differ, max delta " << result.max_delta << ")");
+    } else {
+        INFO(name << ": " << status);
+        return false;
+    }
+    return true;
+}
+
+static std::string json_result(const test::Pose& pose, const std::string& status, const CompareResult& result) {
+    std::stringstream json;
+    json << "{" << test::json_pose(pose) << ", "
+         << "\"status\": \"" << status << "\", "
+         << "\"mismatched_pixels\": " << result.mismatched << ", "
+         << "\"max_delta\": " << result.max_delta << "}";
+    return json.str();
+}
+
+// Logs the result of a whole-batch check, returns true if it failed
+static bool report_check(const std::string& name, bool ok) {
+    if (ok) {
+        INFO(name << ": pass");
+    } else {
+        ERROR(name << ": fail");
+    }
+    return !ok;
+}
+
+// Copies one RGBA frame out of the batch tensor in the layout golden images use
+static void unpack_frame(const Uint8* frame, std::vector<Uint32>& pixels, int w, int h) {
+    pixels.resize(w * h);
+    for (int i = 0; i < w * h; i++) {
+        const Uint8* pixel = frame + i * 4;
+        pixels[i] = (Uint32)pixel[0] << 24 | (Uint32)pixel[1] << 16 | (Uint32)pixel[2] << 8 | pixel[3];
+    }
+}
+
+int main(int argc, char ** argv) {
+    if (argc < 3) {
+        ERROR("Usage: " << argv[0] << " <data path> <golden dir> [output.json] [--update]");
+        return 1;
+    }
+
+    std::string golden_dir = argv[2];
+    std::string output_path = "test.json";
+    bool update = false;
+
+    for (int i = 3; i < argc; i++) {
+        if (std::string(argv[i]) == "--update") {
+            update = true;
+        } else {
+            output_path = argv[i];
+        }
+    }
+
+    if (golden_dir[golden_dir.size()-1] != '/') {
+        golden_dir += '/';
+    }
+
+    test::Harness raycaster(argv[1]);
+    if (!raycaster.load()) {
+        return 1;
+    }
+
+    int w = raycaster.get_width();
+    int h = raycaster.get_height();
+    int failed = 0;
+
+    bool skip_golden = !update && !has_golden_images(golden_dir);
+    if (skip_golden) {
+        WARN("No golden images in '" << golden_dir << "', skipping golden comparison, record them with --update");
+    }
+
+    std::stringstream json;
+    json << "{\n"
+         << "  \"test\": \"golden\",\n"
+         << "  \"golden_skipped\": " << (skip_golden ? "true" : "false") << ",\n"
+         << "  \"width\": " << w << ",\n"
+         << "  \"height\": " << h << ",\n"
+         << "  \"results\": [\n";
+
+    for (int i = 0; i < test::pose_count; i++) {
+        const test::Pose& pose = test::poses[i];
+
+        raycaster.set_camera(pose.pos, pose.angle);
+        raycaster.frame();
+
+        std::vector<Uint32> actual;
+        raycaster.read_frame(actual);
+
+        CompareResult result;
+        std::string status = skip_golden ? "skipped" : check_golden(golden_dir, pose.name, actual, w, h, update, result);
+        failed += report(pose.name, status, result);
+
+        json << "    " << json_result(pose, status, result) << (i + 1 < test::pose_count ? ",\n" : "\n");
+    }
+
+    json << "  ],\n";
+
+    // Software batch renderer, same poses and sprites at the same resolution
+    std::string data_path = argv[1];
+    if (data_path[data_path.size()-1] != '/') {
+        data_path += '/';
+    }
+
+    std::vector<mrt::Texture> rgba_textures;
+    for (const std::string& path : Raycaster::get_texture_paths()) {
+        rgba_textures.push_back(mrt::Texture(nullptr, data_path + path));
+    }
+
+    std::vector<BatchRenderer::Camera> cameras;
+    for (int r = 0; r < batch_repeats; r++) {
+        for (int i = 0; i < test::pose_count; i++) {
+            cameras.push_back(BatchRenderer::Camera(test::poses[i].pos, test::poses[i].angle));
+        }
+    }
+
+    // At least a few threads, so the split across threads is exercised on small machines too
+    int thread_count = std::max(4, (int)std::thread::hardware_concurrency());
+
+    BatchRenderer batch(raycaster.get_map(), rgba_textures, w, h, 4, thread_count);
+    BatchRenderer single_thread(raycaster.get_map(), rgba_textures, w, h, 4, 1);
+    BatchRenderer rgb(raycaster.get_map(), rgba_textures, w, h, 3, thread_count);
+
+    std::vector<BatchRenderer::Sprite> sprites = raycaster.get_sprites();
+    batch.set_sprites(sprites);
+    single_thread.set_sprites(sprites);
+    rgb.set_sprites(sprites);
+
+    std::vector<Uint8> observations, single_thread_observations, rgb_observations;
+    batch.render(cameras, observations);
+    single_thread.render(cameras, single_thread_observations);
+    rgb.render(cameras, rgb_observations);
+
+    size_t frame_size = batch.get_frame_size();
+
+    bool threads_match = observations == single_thread_observations;
+
+    bool repeats_match = true;
+    for (size_t i = test::pose_count; i < cameras.size(); i++) {
+        const Uint8* frame = &observations[i * frame_size];
+        const Uint8* first = &observations[(i % test::pose_count) * frame_size];
+        repeats_match = repeats_match && memcmp(frame, first, frame_size) == 0;
+    }
+
+    bool rgb_matches_rgba = true;
+    for (size_t p = 0; p < cameras.size() * w * h; p++) {
+        for (int c = 0; c < 3; c++) {
+            rgb_matches_rgba = rgb_matches_rgba && rgb_observations[p * 3 + c] == observations[p * 4 + c];
+        }
+    }
+
+    failed += report_check("batch threads (1 vs " + std::to_string(batch.get_thread_count()) + ")", threads_match);
+    failed += report_check("batch repeated poses", repeats_match);
+    failed += report_check("batch rgb layout", rgb_matches_rgba);
+
+    json << "  \"batch\": {\n"
+         << "    \"cameras\": " << cameras.size() << ",\n"
+         << "    \"threads\": " << batch.get_thread_count() << ",\n"
+         << "    \"threads_match\": " << (threads_match ? "true" : "false") << ",\n"
+         << "    \"repeats_match\": " << (repeats_match ? "true" : "false") << ",\n"
+         << "    \"rgb_matches_rgba\": " << (rgb_matches_rgba ? "true" : "false") << ",\n"
+         << "    \"results\": [\n";
+
+    for (int i = 0; i < test::pose_count; i++) {
+        const test::Pose& pose = test::poses[i];
+        std::string name = std::string("batch_") + pose.name;
+
+        std::vector<Uint32> actual;
+        unpack_frame(&observations[i * frame_size], actual, w, h);
+
+        CompareResult result;
+        std::string status = skip_golden ? "skipped" : check_golden(golden_dir, name, actual, w, h, update, result);
+        failed += report(name, status, result);
+
+        json << "      " << json_result(pose, status, result) << (i + 1 < test::pose_count ? ",\n" : "\n");
+    }
+
+    json << "    ]\n"
+         << "  },\n";
+
+    // Palette indexed textures against RGBA ones
+    mrt::Palette palette;
+    std::vector<mrt::Texture> indexed_textures;
+    for (const std::string& path : Raycaster::get_texture_paths()) {
+        indexed_textures.push_back(mrt::Texture(nullptr, data_path + path, true, &palette));
+    }
+
+    int indexed_count = 0;
+    for (const mrt::Texture& texture : indexed_textures) {
+        indexed_count += texture.get_indices() != nullptr;
+    }
+
+    if (!indexed_count) {
+        WARN("No texture was loaded as palette indices, indexed and RGBA frames are trivially equal");
+    }
+
+    std::vector<BatchRenderer::Camera> close_cameras;
+    for (int i = 0; i < close_pose_count; i++) {
+        close_cameras.push_back(BatchRenderer::Camera(close_poses[i].pos, close_poses[i].angle));
+    }
+
+    BatchRenderer rgba_close(raycaster.get_map(), rgba_textures, w, h, 4, thread_count);
+    BatchRenderer indexed_close(raycaster.get_map(), indexed_textures, w, h, 4, thread_count);
+    rgba_close.set_sprites(sprites);
+    indexed_close.set_sprites(sprites);
+
+    std::vector<Uint8> rgba_observations, indexed_observations;
+    rgba_close.render(close_cameras, rgba_observations);
+    indexed_close.render(close_cameras, indexed_observations);
+
+    json << "  \"indexed\": {\n"
+         << "    \"indexed_textures\": " << indexed_count << ",\n"
+         << "    \"results\": [\n";
+
+    for (int i = 0; i < close_pose_count; i++) {
+        const test::Pose& pose = close_poses[i];
+        std::string name = std::string("indexed_") + pose.name;
+
+        std::vector<Uint32> indexed, rgba;
+        unpack_frame(&indexed_observations[i * frame_size], indexed, w, h);
+        unpack_frame(&rgba_observations[i * frame_size], rgba, w, h);
+
+        CompareResult result = compare(indexed, rgba);
+        std::string status = result.mismatched ? "fail" : "pass";
+        failed += report(name, status, result);
+
+        json << "      " << json_result(pose, status, result) << (i + 1 < close_pose_count ? ",\n" : "\n");
+    }
+
+    json << "    ]\n"
+         << "  },\n";
+
+    // Tinted palette in a walled room: one indexed wall texture, one RGBA sprite in front of the camera
+    int wall_texture = -1;
+    int sprite_texture = -1;
+    for (size_t i = 0; i < indexed_textures.size(); i++) {
+        if (indexed_textures[i].get_indices() && wall_texture < 0) {
+            wall_texture = i;
+        } else if (indexed_textures[i].get_pixels() && sprite_texture < 0) {
+            sprite_texture = i;
+        }
+    }
+
+    json << "  \"tint\": {";
+
+    if (wall_texture < 0 || sprite_texture < 0) {
+        WARN("Tint check needs an indexed and an RGBA texture, skipped");
+        json << "\"status\": \"skipped\"},\n";
+    } else {
+        std::vector<int> room(tint_room_size * tint_room_size, 0);
+        for (int i = 0; i < tint_room_size; i++) {
+            room[i] = room[(tint_room_size - 1) * tint_room_size + i] = wall_texture;
+            room[i * tint_room_size] = room[i * tint_room_size + tint_room_size - 1] = wall_texture;
+        }
+        TileMap room_map(tint_room_size, tint_room_size, room);
+
+        mrt::vec2f center(tint_room_size / 2.0f, tint_room_size / 2.0f);
+        std::vector<BatchRenderer::Camera> room_camera {BatchRenderer::Camera(center, 0.0f)};
+        std::vector<BatchRenderer::Sprite> room_sprite {BatchRenderer::Sprite(mrt::vec2f(center.x, center.y + 1.0f), sprite_texture)};
+
+        mrt::Palette tinted = palette.tinted(1.0f, 0.5f, 0.5f);
+        BatchRenderer room_renderer(room_map, indexed_textures, w, h, 4, thread_count);
+
+        // Walls only
+        std::vector<Uint8> walls_plain, walls_tinted;
+        room_renderer.render(room_camera, walls_plain);
+        room_renderer.set_palette(&tinted);
+        room_renderer.render(room_camera, walls_tinted);
+
+        // The sprite only, walls are beyond view distance
+        std::vector<Uint8> sprite_plain, sprite_tinted, empty;
+        room_renderer.set_depth(2.0f);
+        room_renderer.set_sprites(room_sprite);
+        room_renderer.render(room_camera, sprite_tinted);
+        room_renderer.set_palette(nullptr);
+        room_renderer.render(room_camera, sprite_plain);
+        room_renderer.set_sprites({});
+        room_renderer.render(room_camera, empty);
+
+        bool walls_change = walls_plain != walls_tinted;
+        bool sprite_unchanged = sprite_plain == sprite_tinted && sprite_plain != empty;
+
+        failed += report_check("tinted palette recolors indexed walls", walls_change);
+        failed += report_check("tinted palette keeps RGBA sprites", sprite_unchanged);
+
+        json << "\"walls_change\": " << (walls_change ? "true" : "false") << ", "
+             << "\"sprite_unchanged\": " << (sprite_unchanged ? "true" : "false") << "},\n";
+    }
+
+    json << "  \"failed\": " << failed << "\n"
+         << "}\n";
+
+    test::write_file(output_path, json.str());
+
+    if (failed) {
+        ERROR(failed << " checks failed");
+        return 1;
+    }
+
+    if (update) {
+        INFO("Recorded " << 2 * test::pose_count << " golden images in " << golden_dir);
+    } else if (skip_golden) {
+        INFO("Golden comparison skipped, batch and indexed texture checks pass");
+    } else {
+        INFO("All " << test::pose_count << " poses match, on screen and in the batch, indexed textures match RGBA ones");
+    }
+    return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file    texture.cc
+ * @author  maxrt101
+ * @brief   Checks texture mip chains, level selection and blend modes
+ *
+ * Usage: texture
+ *
+ * Builds textures from small images in memory, no data path is needed.
+*/
+
+#include "common.hh"
+
+static int failed = 0;
+
+static void check(const std::string& name, bool ok) {
+    if (ok) {
+        INFO(name << ": pass");
+    } else {
+        ERROR(name << ": fail");
+        failed++;
+    }
+}
+
+// RGBA32 image where texel (x, y) is produced by f(x, y, texel)
+template <typename F>
+static SDL_Surface* create_image(int w, int h, F f) {
+    SDL_Surface* image = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            f(x, y, (Uint8*)image->pixels + y * image->pitch + x * 4);
+        }
+    }
+    return image;
+}
+
+static void set_texel(Uint8* texel, Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
+    texel[0] = r;
+    texel[1] = g;
+    texel[2] = b;
+    texel[3] = a;
+}
+
+static const Uint8* get_texel(const mrt::Texture& texture, int level, int x, int y) {
+    SDL_Surface* surface = texture.get_pixels(level);
+    return (const Uint8*)surface->pixels + y * surface->pitch + x * 4;
+}
+
+// Every kept level has the size get_width/get_height report, down to 1x1
+static bool check_level_sizes(const mrt::Texture& texture) {
+    for (int level = 0; level < texture.get_level_count(); level++) {
+        SDL_Surface* surface = texture.get_pixels(level);
+        if (!surface || surface->w != texture.get_width(level) || surface->h != texture.get_height(level)) {
+            return false;
+        }
+    }
+
+    int last = texture.get_level_count() - 1;
+    return texture.get_width(last) == 1 && texture.get_height(last) == 1;
+}
+
+int main() {
+    // Transparent texels are red, opaque ones blue, red must not bleed into smaller levels
+    SDL_Surface* checker = create_image(4, 4, [](int x, int y, Uint8* texel) {
+        if (x < 2 && y < 2) {
+            set_texel(texel, 0, 0, 255, (x + y) % 2 ? 0 : 255);    // 2 of 4 opaque
+        } else if (x >= 2 && y < 2) {
+            set_texel(texel, 255, 0, 0, 0);                        // All transparent
+        } else {
+            set_texel(texel, 0, 0, 255, 255);                      // All opaque
+        }
+    });
+
+    mrt::Texture alpha(nullptr, checker);
+
+    const Uint8* half = get_texel(alpha, 1, 0, 0);
+    const Uint8* empty = get_texel(alpha, 1, 1, 0);
+    const Uint8* full = get_texel(alpha, 1, 0, 1);
+
+    check("downsample weights color by alpha", half[0] == 0 && half[2] == 255 && half[3] == 127);
+    check("downsample of transparent block", empty[0] == 0 && empty[3] == 0);
+    check("downsample of opaque block", full[2] == 255 && full[3] == 255);
+    check("level count of 4x4", alpha.get_level_count() == 3);
+
+    // Odd sizes round down at every level: 7x5 -> 3x2 -> 1x1
+    SDL_Surface* odd = create_image(7, 5, [](int x, int y, Uint8* texel) {
+        set_texel(texel, x * 30, y * 50, 0, 255);
+    });
+
+    mrt::Texture odd_texture(nullptr, odd);
+    check("non power of two level sizes", check_level_sizes(odd_texture) && odd_texture.get_level_count() == 3);
+
+    SDL_Surface* wide = create_image(9, 2, [](int, int, Uint8* texel) {
+        set_texel(texel, 255, 255, 255, 255);
+    });
+
+    mrt::Texture wide_texture(nullptr, wide);
+    check("non square level sizes", check_level_sizes(wide_texture) && wide_texture.get_level_count() == 4);
+
+    // 64x64 has 7 levels, a level is only picked once it has at least one texel per pixel
+    SDL_Surface* wall = create_image(64, 64, [](int x, int y, Uint8* texel) {
+        set_texel(texel, x * 4, y * 4, 0, 255);
+    });
+
+    mrt::Texture wall_texture(nullptr, wall);
+    check("level count of 64x64", wall_texture.get_level_count() == 7);
+    check("get_level below 2 texels per pixel", wall_texture.get_level(0.5f) == 0 && wall_texture.get_level(1.99f) == 0);
+    check("get_level at powers of two", wall_texture.get_level(2.0f) == 1 && wall_texture.get_level(3.99f) == 1 && wall_texture.get_level(4.0f) == 2);
+    check("get_level clamps to the last level", wall_texture.get_level(1000.0f) == 6);
+
+    // Opaque images are uploaded without blending, images with transparent texels keep it
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, 16, 16, 32, SDL_PIXELFORMAT_RGBA32);
+    SDL_Renderer* renderer = SDL_CreateSoftwareRenderer(target);
+
+    if (renderer) {
+        mrt::Texture opaque_upload(renderer, wall);
+        mrt::Texture alpha_upload(renderer, checker);
+
+        bool opaque_none = true;
+        for (int level = 0; level < opaque_upload.get_level_count(); level++) {
+            SDL_BlendMode mode;
+            SDL_GetTextureBlendMode(opaque_upload.get_sdl_texture(level), &mode);
+            opaque_none = opaque_none && mode == SDL_BLENDMODE_NONE;
+        }
+
+        SDL_BlendMode alpha_mode;
+        SDL_GetTextureBlendMode(alpha_upload.get_sdl_texture(), &alpha_mode);
+
+        check("opaque texture blend mode", opaque_none);
+        check("transparent texture blend mode", alpha_mode == SDL_BLENDMODE_BLEND);
+    } else {
+        SDL_ERROR("Can't create software renderer");
+        failed++;
+    }
+
+    if (renderer) {
+        SDL_DestroyRenderer(renderer);
+    }
+
+    SDL_FreeSurface(target);
+    SDL_FreeSurface(checker);
+    SDL_FreeSurface(odd);
+    SDL_FreeSurface(wide);
+    SDL_FreeSurface(wall);
+
+    if (failed) {
+        ERROR(failed << " checks failed");
+        return 1;
+    }
+
+    INFO("All texture checks pass");
+    return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file    traversal.cc
+ * @author  maxrt101
+ * @brief   Checks that empty block leaps find the same walls as the plain march
+ *
+ * Usage: traversal [columns]
+ *
+ * Casts rays for every pose from common.hh on the default map and for the
+ * open map poses, with and without skipping empty blocks, and compares hits.
+*/
+
+#include "common.hh"
+
+#include <cstdlib>
+
+// Returns the number of columns whose hits differ
+static int compare_pose(const TileMap& map, const test::Pose& pose, int columns, float depth) {
+    std::vector<RayHit> march, leap;
+    test::cast_rays(map, pose, columns, depth, false, march);
+    test::cast_rays(map, pose, columns, depth, true, leap);
+
+    int mismatched = 0;
+
+    for (int x = 0; x < columns; x++) {
+        const RayHit& a = march[x];
+        const RayHit& b = leap[x];
+
+        if (a.tile.x != b.tile.x || a.tile.y != b.tile.y || a.side != b.side || a.is_wall != b.is_wall || a.distance != b.distance || a.sample_x != b.sample_x) {
+            if (!mismatched) {
+                ERROR(pose.name << ": column " << x << " hits tile " << b.tile.x << "," << b.tile.y << " at " << b.distance
+                      << ", plain march hits " << a.tile.x << "," << a.tile.y << " at " << a.distance);
+            }
+            mismatched++;
+        }
+    }
+
+    if (mismatched) {
+        ERROR(pose.name << ": " << mismatched << " of " << columns << " columns differ");
+    } else {
+        INFO(pose.name << ": pass");
+    }
+
+    return mismatched;
+}
+
+int main(int argc, char ** argv) {
+    int columns = argc > 1 ? atoi(argv[1]) : 4096;
+
+    if (columns <= 0) {
+        ERROR("Column count must be positive");
+        return 1;
+    }
+
+    TileMap map = Raycaster::get_default_map();
+    TileMap open_map = test::get_open_map();
+    int failed = 0;
+
+    for (int i = 0; i < test::pose_count; i++) {
+        failed += compare_pose(map, test::poses[i], columns, test::depth) != 0;
+    }
+
+    for (int i = 0; i < test::open_pose_count; i++) {
+        failed += compare_pose(open_map, test::open_poses[i], columns, test::open_map_depth) != 0;
+    }
+
+    if (failed) {
+        ERROR(failed << " of " << test::pose_count + test::open_pose_count << " poses failed");
+        return 1;
+    }
+
+    INFO("All " << test::pose_count + test::open_pose_count << " poses match the plain march");
+    return 0;
+}